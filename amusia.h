@@ -1,9 +1,15 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cmath>
+#include <cstdint>
 #include <functional>
+#include <iterator>
 #include <sndfile.hh>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace amusia {
@@ -16,30 +22,145 @@ inline double granularize(double value, double size) {
   return steps * size;
 }
 
+// helpers for exp2Constexpr and EqualTemperament::ratio, not part of the api
+namespace detail {
+// std::floor is not constexpr. expects |value| < 2^63
+constexpr double floorConstexpr(double value) {
+  const auto truncated = static_cast<double>(static_cast<long long>(value));
+  return truncated > value ? truncated - 1 : truncated;
+}
+
+// an unevaluated sum of two doubles, about 106 bits of precision regardless of
+// how big long double is. only what exp2Constexpr needs is implemented, and
+// it assumes operations are not fused (ie -ffp-contract=off or compile time)
+struct DoubleDouble {
+  double hi;
+  double lo;
+};
+
+constexpr DoubleDouble twoSum(double a, double b) {
+  const double sum = a + b;
+  const double bPart = sum - a;
+  return {sum, (a - (sum - bPart)) + (b - bPart)};
+}
+
+// requires |a| >= |b|
+constexpr DoubleDouble quickTwoSum(double a, double b) {
+  const double sum = a + b;
+  return {sum, b - (sum - a)};
+}
+
+// splits value into two halves of 26 bits each, so that their products are
+// exact
+constexpr DoubleDouble split(double value) {
+  const double scaled = 134217729.0 * value;  // 2^27 + 1
+  const double hi = scaled - (scaled - value);
+  return {hi, value - hi};
+}
+
+constexpr DoubleDouble twoProduct(double a, double b) {
+  const double product = a * b;
+  const DoubleDouble aSplit = split(a);
+  const DoubleDouble bSplit = split(b);
+  return {product, ((aSplit.hi * bSplit.hi - product) + aSplit.hi * bSplit.lo +
+                    aSplit.lo * bSplit.hi) +
+                       aSplit.lo * bSplit.lo};
+}
+
+constexpr DoubleDouble operator+(DoubleDouble a, DoubleDouble b) {
+  const DoubleDouble hi = twoSum(a.hi, b.hi);
+  const DoubleDouble lo = twoSum(a.lo, b.lo);
+  const DoubleDouble sum = quickTwoSum(hi.hi, hi.lo + lo.hi);
+  return quickTwoSum(sum.hi, sum.lo + lo.lo);
+}
+
+constexpr DoubleDouble operator*(DoubleDouble a, DoubleDouble b) {
+  const DoubleDouble product = twoProduct(a.hi, b.hi);
+  return quickTwoSum(product.hi, product.lo + (a.hi * b.lo + a.lo * b.hi));
+}
+
+constexpr DoubleDouble operator/(DoubleDouble a, double b) {
+  const double hi = a.hi / b;
+  const DoubleDouble product = twoProduct(hi, b);
+  return quickTwoSum(hi, (((a.hi - product.hi) - product.lo) + a.lo) / b);
+}
+}  // namespace detail
+
+// std::exp2 is not constexpr, this is for tables computed at compile time.
+// 2^exponent, evaluated in double double and then rounded, so the result is
+// correctly rounded unless it is subnormal. std::pow(2, exponent) is usually
+// the same, but may be an ulp off
+constexpr double exp2Constexpr(double exponent) {
+  constexpr detail::DoubleDouble ln2 = {0x1.62e42fefa39efp-1,
+                                        0x1.abc9e3b39803fp-56};
+  const double whole = detail::floorConstexpr(exponent);
+  // e^(fraction * ln2) by its taylor series, which converges quickly as
+  // fraction * ln2 is in [0, ln2)
+  const detail::DoubleDouble x = detail::twoSum(exponent, -whole) * ln2;
+  detail::DoubleDouble term = {1, 0};
+  detail::DoubleDouble result = {1, 0};
+  for (int n = 1; n < 32; ++n) {
+    term = term * x / n;
+    result = result + term;
+  }
+  // scaling by 2 is exact, until the result is subnormal
+  double rounded = result.hi + result.lo;
+  for (double i = 0; i < whole; i += 1) {
+    rounded *= 2;
+  }
+  for (double i = 0; i > whole; i -= 1) {
+    rounded /= 2;
+  }
+  return rounded;
+}
+
 //  0 < value <= 1, but left open for intentional abuse ;)
 inline double granularize(double value, double max, double n) {
   const double stepSize = max / n;
   return granularize(value * max, stepSize);
 }
 
+// the part of curlicue which depends only on i, i * i modulo tau
+inline double curlicueSquare(double i) {
+  return std::fmod(i * std::fmod(i, tau), tau);
+}
+
+// the rest of curlicue, given the result of curlicueSquare(i)
+inline double curlicueFromSquare(double square, double k) {
+  return std::fmod(square * k, tau);
+}
+
 inline double curlicue(double i, double k) {
   // a = i * i * k, with modular arithmetic to get around overflow (angular
   // arithmetic is modular by tau)
-  return std::fmod(std::fmod(i * std::fmod(i, tau), tau) * k, tau);
+  return curlicueFromSquare(curlicueSquare(i), k);
+}
+
+// the steps applied to a curlicue value by the functions below, shared with
+// the batch versions so that the two always agree
+inline double curlicueNormalize(double value) { return value / tau; }
+
+template <class T>
+T curlicueSelectNormalized(double normalized, T n) {
+  return static_cast<T>(std::floor(n * normalized));
+}
+
+inline bool curlicueOddsNormalized(double normalized, double odds) {
+  return normalized < odds;
 }
 
 // returns value between 0 and 1 instead of 0 and tau
 inline double curlicueNormalized(double i, double k) {
-  return curlicue(i, k) / tau;
+  return curlicueNormalize(curlicue(i, k));
 }
 
 template <class T>
 T curlicueSelect(double i, double k, T n) {
-  return static_cast<T>(std::floor(n * curlicueNormalized(i, k)));
+  return curlicueSelectNormalized(curlicueNormalized(i, k), n);
 }
 
 inline bool curlicueOdds(double i, double k, double odds = 0.5) {
-  return curlicueNormalized(i, k) < odds;
+  return curlicueOddsNormalized(curlicueNormalized(i, k), odds);
 }
 
 template <class ArrayLike>
@@ -47,12 +168,97 @@ auto& curlicueSelectFrom(double i, double k, const ArrayLike& values) {
   return values[curlicueSelect(i, k, std::size(values))];
 }
 
+// batch versions of the above, for when many values are wanted at once (ie when
+// searching or scoring candidate sequences). each evaluates every i in
+// [first, first + count) against every k in ks, writing count * size(ks)
+// values to out ordered by i and then by k, so out[n * size(ks) + j] is the
+// value for i = first + n and k = ks[j]. curlicueSquare is evaluated once per
+// i instead of once per value, and the results agree exactly with the scalar
+// functions
+template <class KRange, class OutputIt, class Transform>
+OutputIt curlicueTransformBatch(double first, std::size_t count,
+                                const KRange& ks, Transform transform,
+                                OutputIt out) {
+  for (std::size_t n = 0; n < count; ++n) {
+    const double square = curlicueSquare(first + static_cast<double>(n));
+    for (const auto k : ks) {
+      *out = transform(curlicueFromSquare(square, static_cast<double>(k)));
+      ++out;
+    }
+  }
+  return out;
+}
+
+template <class KRange, class OutputIt>
+OutputIt curlicueBatch(double first, std::size_t count, const KRange& ks,
+                       OutputIt out) {
+  return curlicueTransformBatch(
+      first, count, ks, [](double value) { return value; }, out);
+}
+
+template <class KRange, class OutputIt>
+OutputIt curlicueNormalizedBatch(double first, std::size_t count,
+                                 const KRange& ks, OutputIt out) {
+  return curlicueTransformBatch(
+      first, count, ks, [](double value) { return curlicueNormalize(value); },
+      out);
+}
+
+template <class T, class KRange, class OutputIt>
+OutputIt curlicueSelectBatch(double first, std::size_t count, const KRange& ks,
+                             T n, OutputIt out) {
+  return curlicueTransformBatch(
+      first, count, ks,
+      [n](double value) {
+        return curlicueSelectNormalized(curlicueNormalize(value), n);
+      },
+      out);
+}
+
+template <class KRange, class OutputIt>
+OutputIt curlicueOddsBatch(double first, std::size_t count, const KRange& ks,
+                           double odds, OutputIt out) {
+  return curlicueTransformBatch(
+      first, count, ks,
+      [odds](double value) {
+        return curlicueOddsNormalized(curlicueNormalize(value), odds);
+      },
+      out);
+}
+
+// odds of 0.5, the default of curlicueOdds
+template <class KRange, class OutputIt>
+OutputIt curlicueOddsBatch(double first, std::size_t count, const KRange& ks,
+                           OutputIt out) {
+  return curlicueOddsBatch(first, count, ks, 0.5, out);
+}
+
+template <class KRange, class ArrayLike, class OutputIt>
+OutputIt curlicueSelectFromBatch(double first, std::size_t count,
+                                 const KRange& ks, const ArrayLike& values,
+                                 OutputIt out) {
+  const auto n = std::size(values);
+  return curlicueTransformBatch(
+      first, count, ks,
+      [n, &values](double value) -> decltype(auto) {
+        return values[curlicueSelectNormalized(curlicueNormalize(value), n)];
+      },
+      out);
+}
+
 namespace scales {
 struct EqualTemperament {
   double operator()(double n) const {
     return std::pow(2, std::floor(n + adjuster) / notesPerOctave);
   }
 
+  // operator(), usable at compile time. they agree for every note of
+  // twelveToneFrequencies, though std::pow may be an ulp off elsewhere
+  constexpr double ratio(double n) const {
+    return exp2Constexpr(detail::floorConstexpr(n + adjuster) /
+                         notesPerOctave);
+  }
+
   const double notesPerOctave;
   const double adjuster;
 };
@@ -63,7 +269,36 @@ inline double equalTemperament(double n, double notesPerOctave,
 }
 
 // tuned to standard tuning (A440)
-const auto twelveToneEqualTemperament = EqualTemperament{12, 0.3764f};
+constexpr auto twelveToneEqualTemperament = EqualTemperament{12, 0.3764f};
+
+// the frequencies of Size consecutive notes starting at firstNote, computed at
+// compile time when the table is constexpr. notes outside of the table fall
+// back to calling the temperament
+template <std::size_t Size>
+struct FrequencyTable {
+  constexpr FrequencyTable(EqualTemperament temperament, int firstNote = 0)
+      : temperament(temperament), firstNote(firstNote) {
+    for (std::size_t i = 0; i < Size; ++i) {
+      frequencies[i] = temperament.ratio(firstNote + static_cast<double>(i));
+    }
+  }
+
+  constexpr double operator()(int note) const {
+    const long long index = static_cast<long long>(note) - firstNote;
+    return index >= 0 && index < static_cast<long long>(Size)
+               ? frequencies[static_cast<std::size_t>(index)]
+               : temperament(static_cast<double>(note));
+  }
+
+  const EqualTemperament temperament;
+  const int firstNote;
+  std::array<double, Size> frequencies{};
+};
+
+// c in octave 0 through b in octave 10
+constexpr std::size_t twelveToneNotes = 132;
+constexpr FrequencyTable<twelveToneNotes> twelveToneFrequencies{
+    twelveToneEqualTemperament};
 }  // namespace scales
 
 namespace notes {
@@ -89,134 +324,251 @@ constexpr int b = 11;
 constexpr int bSharp = 12;
 constexpr int cFlat = 11;
 
-inline double frequency(int note) {
-  return scales::twelveToneEqualTemperament(static_cast<double>(note));
+constexpr double frequency(int note) {
+  return scales::twelveToneFrequencies(note);
 }
 
-inline int octave(int note, int octaveAugment, int notes_per_octave = 12) {
+constexpr int octave(int note, int octaveAugment, int notes_per_octave = 12) {
   return note + octaveAugment * notes_per_octave;
 }
 }  // namespace notes
 
-struct NoteList {
-  NoteList() = default;
-  NoteList(const NoteList&) = default;
-  NoteList(NoteList&&) = default;
-  NoteList(std::initializer_list<int> notes) : notes_(std::move(notes)) {}
+// a list of notes stored inline (no heap allocation), usable at compile time.
+// notes in [0, indexSize) are also recorded in a bit index, making contains
+// and find on a missing note constant time. to keep the index correct, notes
+// are only ever changed through the list's own functions (ie set), iterators
+// and operator[] are read only
+template <std::size_t Capacity>
+struct BasicNoteList {
+  static constexpr int indexSize = 256;
+
+  BasicNoteList() = default;
+  BasicNoteList(const BasicNoteList&) = default;
+  BasicNoteList(BasicNoteList&&) = default;
+  constexpr BasicNoteList(std::initializer_list<int> notes) { push(notes); }
+
+  // copies a list of another capacity, ie to extend a NoteList further than
+  // it has room for
+  template <std::size_t OtherCapacity>
+  constexpr explicit BasicNoteList(const BasicNoteList<OtherCapacity>& notes) {
+    for (const int note : notes) {
+      push(note);
+    }
+  }
 
-  using iterator = std::vector<int>::iterator;
-  using const_iterator = std::vector<int>::const_iterator;
+  using iterator = const int*;
+  using const_iterator = const int*;
 
-  NoteList clone() const { return *this; }
+  constexpr BasicNoteList clone() const { return *this; }
 
-  NoteList& push(int note) {
-    notes_.push_back(note);
+  constexpr BasicNoteList& push(int note) {
+    if (size_ == Capacity) {
+      throw std::length_error("amusia::BasicNoteList capacity exceeded");
+    }
+    notes_[size_++] = note;
+    addToIndex(note);
     return *this;
   }
 
-  NoteList& push(std::initializer_list<int> notes) {
-    notes_.insert(notes_.end(), std::move(notes));
+  constexpr BasicNoteList& push(std::initializer_list<int> notes) {
+    for (const int note : notes) {
+      push(note);
+    }
     return *this;
   }
 
-  NoteList& translate(int amount) {
-    for (int& note : notes_) {
-      note += amount;
+  constexpr BasicNoteList& set(std::size_t index, int note) {
+    if (index >= size_) {
+      throw std::out_of_range("amusia::BasicNoteList index out of range");
     }
+    const int previous = notes_[index];
+    notes_[index] = note;
+    removeFromIndex(previous);
+    addToIndex(note);
     return *this;
   }
 
-  NoteList& translate_octave(int octave_amount, int notes_per_octave = 12) {
+  constexpr BasicNoteList& translate(int amount) {
+    clearIndex();
+    for (std::size_t i = 0; i < size_; ++i) {
+      notes_[i] += amount;
+      addToIndex(notes_[i]);
+    }
+    return *this;
+  }
+
+  constexpr BasicNoteList& translate_octave(int octave_amount,
+                                            int notes_per_octave = 12) {
     return translate(octave_amount * notes_per_octave);
   }
 
-  NoteList& extend(int number_of_octaves, int notes_per_octave = 12) {
-    const std::size_t original_size = notes_.size();
+  constexpr BasicNoteList& extend(int number_of_octaves,
+                                  int notes_per_octave = 12) {
+    const std::size_t original_size = size_;
     for (int octave = 1; octave <= number_of_octaves; ++octave) {
       const int offset = octave * notes_per_octave;
       for (std::size_t i = 0; i < original_size; ++i) {
-        notes_.push_back(notes_[i] + offset);
+        push(notes_[i] + offset);
       }
     }
     return *this;
   }
 
-  NoteList& extend_root(int number_of_octaves = 1, int notes_per_octave = 12) {
-    notes_.push_back(notes_[0] + number_of_octaves * notes_per_octave);
-    return *this;
+  constexpr BasicNoteList& extend_root(int number_of_octaves = 1,
+                                       int notes_per_octave = 12) {
+    return push(notes_[0] + number_of_octaves * notes_per_octave);
   }
 
-  NoteList& sort() {
-    std::sort(begin(), end());
+  // insertion sort, lists are short and std::sort is not constexpr
+  constexpr BasicNoteList& sort() {
+    for (std::size_t i = 1; i < size_; ++i) {
+      const int note = notes_[i];
+      std::size_t j = i;
+      for (; j > 0 && notes_[j - 1] > note; --j) {
+        notes_[j] = notes_[j - 1];
+      }
+      notes_[j] = note;
+    }
     return *this;
   }
 
-  iterator find(int note) { return std::find(begin(), end(), note); }
-
-  const_iterator find(int note) const {
-    return std::find(begin(), end(), note);
+  constexpr const_iterator find(int note) const {
+    return begin() + findIndex(note);
   }
 
-  bool contains(int note) const { return find(note) != end(); }
+  constexpr bool contains(int note) const {
+    if (note >= 0 && note < indexSize) {
+      return (index_[note / 64] >> (note % 64)) & 1;
+    }
+    return unindexed_ != 0 && findIndex(note) != size_;
+  }
 
-  bool operator==(const NoteList& other) const {
-    return notes_ == other.notes_;
+  constexpr bool operator==(const BasicNoteList& other) const {
+    if (size_ != other.size_) {
+      return false;
+    }
+    for (std::size_t i = 0; i < size_; ++i) {
+      if (notes_[i] != other.notes_[i]) {
+        return false;
+      }
+    }
+    return true;
   }
 
-  bool operator!=(const NoteList& other) const {
-    return notes_ != other.notes_;
+  constexpr bool operator!=(const BasicNoteList& other) const {
+    return !(*this == other);
   }
 
-  bool operator<(const NoteList& other) const { return notes_ < other.notes_; }
+  constexpr bool operator<(const BasicNoteList& other) const {
+    for (std::size_t i = 0; i < size_ && i < other.size_; ++i) {
+      if (notes_[i] != other.notes_[i]) {
+        return notes_[i] < other.notes_[i];
+      }
+    }
+    return size_ < other.size_;
+  }
 
-  bool operator<=(const NoteList& other) const {
-    return notes_ <= other.notes_;
+  constexpr bool operator<=(const BasicNoteList& other) const {
+    return !(other < *this);
   }
 
-  bool operator>(const NoteList& other) const { return notes_ > other.notes_; }
+  constexpr bool operator>(const BasicNoteList& other) const {
+    return other < *this;
+  }
 
-  bool operator>=(const NoteList& other) const {
-    return notes_ >= other.notes_;
+  constexpr bool operator>=(const BasicNoteList& other) const {
+    return !(*this < other);
   }
 
-  iterator begin() { return notes_.begin(); }
-  const_iterator begin() const { return notes_.begin(); }
-  iterator end() { return notes_.end(); }
-  const_iterator end() const { return notes_.end(); }
+  constexpr const_iterator begin() const { return notes_.data(); }
+  constexpr const_iterator end() const { return notes_.data() + size_; }
 
-  const std::size_t size() const { return notes_.size(); }
+  constexpr const std::size_t size() const { return size_; }
 
-  int& operator[](std::size_t index) { return notes_[index]; }
-  const int& operator[](std::size_t index) const { return notes_[index]; }
+  constexpr const int& operator[](std::size_t index) const {
+    return notes_[index];
+  }
 
  private:
-  std::vector<int> notes_;
+  constexpr std::size_t findIndex(int note) const {
+    if (note >= 0 && note < indexSize && !contains(note)) {
+      return size_;
+    }
+    return scan(note);
+  }
+
+  // a linear search, not using the index
+  constexpr std::size_t scan(int note) const {
+    std::size_t i = 0;
+    while (i < size_ && notes_[i] != note) {
+      ++i;
+    }
+    return i;
+  }
+
+  constexpr void addToIndex(int note) {
+    if (note >= 0 && note < indexSize) {
+      index_[note / 64] |= std::uint64_t(1) << (note % 64);
+    } else {
+      ++unindexed_;
+    }
+  }
+
+  // a note is only dropped from the index once no copies of it are left
+  constexpr void removeFromIndex(int note) {
+    if (note < 0 || note >= indexSize) {
+      --unindexed_;
+    } else if (scan(note) == size_) {
+      index_[note / 64] &= ~(std::uint64_t(1) << (note % 64));
+    }
+  }
+
+  constexpr void clearIndex() {
+    for (auto& word : index_) {
+      word = 0;
+    }
+    unindexed_ = 0;
+  }
+
+  std::array<int, Capacity> notes_{};
+  std::size_t size_ = 0;
+  std::array<std::uint64_t, indexSize / 64> index_{};
+  // number of notes outside of the index
+  std::size_t unindexed_ = 0;
 };
 
+// holds up to 32 notes, ie a 5 note chord over 6 octaves or a scale over 4,
+// and push throws std::length_error past that. storage is fixed rather than
+// spilling to the heap, since a heap allocated list could not be used at
+// compile time (it would need a constexpr destructor, which is C++20). for
+// longer lists use a bigger BasicNoteList, ie
+// BasicNoteList<scales::twelveToneNotes>(scales::major).extend(10)
+using NoteList = BasicNoteList<32>;
+
 namespace scales {
-const NoteList major = {0, 2, 4, 5, 7, 9, 11};
-const NoteList minor = {0, 2, 3, 5, 7, 8, 10};
-const NoteList harmonicMinor = {0, 2, 3, 5, 7, 8, 11};
-const NoteList majorBlues = {0, 2, 4, 7, 9, 10};
-const NoteList minorBlues = {0, 2, 3, 7, 8, 10};
+constexpr NoteList major = {0, 2, 4, 5, 7, 9, 11};
+constexpr NoteList minor = {0, 2, 3, 5, 7, 8, 10};
+constexpr NoteList harmonicMinor = {0, 2, 3, 5, 7, 8, 11};
+constexpr NoteList majorBlues = {0, 2, 4, 7, 9, 10};
+constexpr NoteList minorBlues = {0, 2, 3, 7, 8, 10};
 }  // namespace scales
 
 namespace arpeggios {
-const NoteList major = {0, 4, 7};
-const NoteList minor = {0, 3, 7};
-const NoteList diminished = {0, 3, 6};
-const NoteList diminishedSeven = {0, 3, 6, 9};
-const NoteList augmented = {0, 4, 8};
-const NoteList majorSix = {0, 4, 7, 9};
-const NoteList minorSix = {0, 3, 7, 9};
-const NoteList majorSeven = {0, 4, 7, 10};
-const NoteList minorSeven = {0, 3, 7, 10};
-const NoteList majorNine = {0, 4, 7, 10, 14};
-const NoteList minorNine = {0, 3, 7, 10, 14};
-const NoteList majorMajorSeven = {0, 4, 7, 11};
-const NoteList minorMajorSeven = {0, 3, 7, 11};
-const NoteList majorMajorNine = {0, 4, 7, 11, 13};
-const NoteList minorMajorNine = {0, 3, 7, 11, 13};
+constexpr NoteList major = {0, 4, 7};
+constexpr NoteList minor = {0, 3, 7};
+constexpr NoteList diminished = {0, 3, 6};
+constexpr NoteList diminishedSeven = {0, 3, 6, 9};
+constexpr NoteList augmented = {0, 4, 8};
+constexpr NoteList majorSix = {0, 4, 7, 9};
+constexpr NoteList minorSix = {0, 3, 7, 9};
+constexpr NoteList majorSeven = {0, 4, 7, 10};
+constexpr NoteList minorSeven = {0, 3, 7, 10};
+constexpr NoteList majorNine = {0, 4, 7, 10, 14};
+constexpr NoteList minorNine = {0, 3, 7, 10, 14};
+constexpr NoteList majorMajorSeven = {0, 4, 7, 11};
+constexpr NoteList minorMajorSeven = {0, 3, 7, 11};
+constexpr NoteList majorMajorNine = {0, 4, 7, 11, 13};
+constexpr NoteList minorMajorNine = {0, 3, 7, 11, 13};
 }  // namespace arpeggios
 
 // a voice is a function taking frequency and time, and returning a number
@@ -380,7 +732,11 @@ using WaveFileBuilder = BasicWaveFileBuilder<double>;
 
 template <class T>
 struct BasicWaveMemoryBuilder {
-  BasicWaveMemoryBuilder(int sampleRate = 48000) : sampleRate(sampleRate) {
+  // startSeconds is the time the first note starts at, which allows part of a
+  // piece to be rendered on its own with the same samples it would have in the
+  // full piece. getDurationSeconds includes it
+  BasicWaveMemoryBuilder(int sampleRate = 48000, double startSeconds = 0)
+      : sampleRate(sampleRate), durationSeconds(startSeconds) {
     // TODO: Check valid sample rate. Should not be <= 0 (and should not be
     // other invalid sample rates)
   }
@@ -428,6 +784,15 @@ struct BasicWaveMemoryBuilder {
     durationSeconds = 0;
   }
 
+  const std::vector<T>& getBuffer() const { return buffer; }
+
+  // moves the samples out, leaving the builder cleared
+  std::vector<T> takeBuffer() {
+    std::vector<T> taken = std::move(buffer);
+    clear();
+    return taken;
+  }
+
   void mix(const BasicWaveMemoryBuilder& wave, T weight = T(0.5)) {
     const std::size_t n = std::min(buffer.size(), wave.buffer.size());
     const auto a = buffer.data();
@@ -496,4 +861,285 @@ auto repeat(SequenceType sequence, N n) {
     }
   };
 }
+
+inline std::size_t hashCombine(std::size_t seed, std::size_t value) {
+  return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+// std::hash where it exists, otherwise the elements of a container or other
+// range (ie a NoteList, or a std::vector<double> of frequencies)
+template <class T>
+std::size_t hashValue(const T& value) {
+  if constexpr (std::is_default_constructible<std::hash<T>>::value) {
+    return std::hash<T>{}(value);
+  } else {
+    std::size_t seed = 0;
+    std::size_t size = 0;
+    for (const auto& element : value) {
+      seed = hashCombine(seed, hashValue(element));
+      ++size;
+    }
+    return hashCombine(seed, size);
+  }
+}
+
+// hashes everything that affects what a segment writes, ie
+// hashParameters(chord, numNotes, k, firstNote, voiceId). voices can't be
+// hashed, so pass something identifying them instead
+template <class... Parameters>
+std::size_t hashParameters(const Parameters&... parameters) {
+  std::size_t seed = 0;
+  ((seed = hashCombine(seed, hashValue(parameters))), ...);
+  return seed;
+}
+
+// A segment is a sequence which can be rendered on its own. it writes notes to
+// the WaveBuilder it is given, which starts at the time the segment starts, and
+// comes with a hash of its parameters (see hashParameters) so that changes to
+// it can be detected. unlike sequences, a segment must not depend on state
+// left behind by earlier segments (such as a shared note counter), that should
+// be one of its parameters instead
+//
+// example:
+// Segment{hashParameters(frequencies), [frequencies](WaveMemoryBuilder& wave)
+// { for (auto frequency : frequencies)
+// wave.addNote(frequency, 0.75, 1 / 8.0, voices::sine ); }}
+template <class T>
+struct BasicSegment {
+  std::size_t hash;
+  std::function<void(BasicWaveMemoryBuilder<T>&)> render;
+};
+
+using Segment = BasicSegment<double>;
+
+// renders tracks made of segments, mixed the same way as
+// BasicWaveMemoryBuilder::mix_to. rendering again after changing the segments
+// re-renders only the segments whose hash or start time changed, and re-mixes
+// only the samples they cover, producing the same samples as a full render
+template <class T>
+struct BasicIncrementalRenderer {
+  BasicIncrementalRenderer(int sampleRate = 48000) : sampleRate(sampleRate) {}
+
+  int getSampleRate() const { return sampleRate; }
+
+  int getNumChannels() const { return 1; }
+
+  std::size_t getNumTracks() const { return tracks.size(); }
+
+  // replaces the segments of a track, adding tracks as needed. nothing is
+  // rendered until render is called
+  void setTrack(std::size_t track, std::vector<BasicSegment<T>> segments) {
+    if (track >= tracks.size()) {
+      tracks.resize(track + 1);
+      remixAll = true;
+    }
+    tracks[track].segments = std::move(segments);
+  }
+
+  // later tracks move down by one, keeping what they have rendered
+  void removeTrack(std::size_t track) {
+    tracks.erase(tracks.begin() + track);
+    remixAll = true;
+  }
+
+  void clear() {
+    tracks.clear();
+    buffer.clear();
+    remixAll = true;
+  }
+
+  const std::vector<T>& render() {
+    std::vector<Span> dirty;
+    for (auto& track : tracks) {
+      renderTrack(track, dirty);
+    }
+
+    if (tracks.empty()) {
+      buffer.clear();
+      remixAll = true;
+      return buffer;
+    }
+
+    // the first of the shortest tracks, like mix_to
+    std::size_t shortest = 0;
+    for (std::size_t i = 1; i < tracks.size(); ++i) {
+      if (tracks[i].durationSeconds < tracks[shortest].durationSeconds) {
+        shortest = i;
+      }
+    }
+
+    // the weight of every track depends on the shortest and on the number of
+    // tracks, so if either changed (or tracks moved) everything is re-mixed
+    const std::size_t size = tracks[shortest].buffer.size();
+    if (remixAll || shortest != mixedShortest) {
+      dirty.assign(1, Span(0, size));
+    } else if (size > buffer.size()) {
+      dirty.emplace_back(buffer.size(), size);
+    }
+    buffer.resize(size);
+    mixedShortest = shortest;
+    remixAll = false;
+
+    // tracks edited in the same place report overlapping spans, each sample
+    // is only mixed once
+    std::sort(dirty.begin(), dirty.end());
+    std::size_t mixedTo = 0;
+    for (const auto& span : dirty) {
+      const std::size_t last = std::min(span.second, size);
+      mix(std::max(span.first, mixedTo), last, shortest);
+      mixedTo = std::max(mixedTo, last);
+    }
+    return buffer;
+  }
+
+  const std::vector<T>& getBuffer() const { return buffer; }
+
+  bool toFile(const char* filename,
+              int format = SF_FORMAT_WAV | SF_FORMAT_PCM_16) const {
+    SndfileHandle file(filename, SFM_WRITE, format, 1, sampleRate);
+    file.write(buffer.data(), buffer.size());
+    return true;
+  }
+
+ private:
+  // a range of samples, [first, second)
+  using Span = std::pair<std::size_t, std::size_t>;
+
+  // where a segment was rendered to within its track
+  struct RenderedSegment {
+    std::size_t hash;
+    double startSeconds;
+    double endSeconds;
+    std::size_t firstSample;
+    std::size_t numSamples;
+  };
+
+  struct Track {
+    std::vector<BasicSegment<T>> segments;
+    std::vector<RenderedSegment> rendered;
+    std::vector<T> buffer;
+    double durationSeconds = 0;
+  };
+
+  static void addSpan(std::vector<Span>& spans, std::size_t first,
+                      std::size_t last) {
+    if (first == last) {
+      return;
+    }
+    if (!spans.empty() && spans.back().second == first) {
+      spans.back().second = last;
+    } else {
+      spans.emplace_back(first, last);
+    }
+  }
+
+  // a segment is reused when it has the same hash and starts at the same time
+  // as the segment rendered at the same position last time, as voices depend
+  // on the time. the start time is carried over from the end of the previous
+  // segment, exactly as a single WaveBuilder would accumulate it
+  void renderTrack(Track& track, std::vector<Span>& dirty) const {
+    const std::size_t numSegments = track.segments.size();
+    std::vector<RenderedSegment> rendered;
+    rendered.reserve(numSegments);
+    std::vector<std::vector<T>> renderedBuffers(numSegments);
+    std::vector<bool> reused(numSegments, false);
+
+    double seconds = 0;
+    for (std::size_t i = 0; i < numSegments; ++i) {
+      const auto& segment = track.segments[i];
+      if (i < track.rendered.size() && track.rendered[i].hash == segment.hash &&
+          track.rendered[i].startSeconds == seconds) {
+        rendered.push_back(track.rendered[i]);
+        reused[i] = true;
+      } else {
+        BasicWaveMemoryBuilder<T> wave(sampleRate, seconds);
+        segment.render(wave);
+        const double endSeconds = wave.getDurationSeconds();
+        renderedBuffers[i] = wave.takeBuffer();
+        rendered.push_back(
+            {segment.hash, seconds, endSeconds, 0, renderedBuffers[i].size()});
+      }
+      seconds = rendered.back().endSeconds;
+    }
+
+    // lay the segments out, keeping the old buffer if nothing moved
+    std::size_t size = 0;
+    bool moved = false;
+    for (std::size_t i = 0; i < numSegments; ++i) {
+      moved = moved || (reused[i] && rendered[i].firstSample != size);
+      size += rendered[i].numSamples;
+    }
+    moved = moved || size != track.buffer.size();
+
+    std::vector<T> buffer;
+    if (moved) {
+      buffer.resize(size);
+    }
+    std::size_t first = 0;
+    for (std::size_t i = 0; i < numSegments; ++i) {
+      auto& segment = rendered[i];
+      if (reused[i]) {
+        if (moved) {
+          const auto source = track.buffer.begin() + segment.firstSample;
+          std::copy(source, source + segment.numSamples, buffer.begin() + first);
+          if (segment.firstSample != first) {
+            addSpan(dirty, first, first + segment.numSamples);
+          }
+        }
+      } else {
+        std::copy(renderedBuffers[i].begin(), renderedBuffers[i].end(),
+                  (moved ? buffer : track.buffer).begin() + first);
+        addSpan(dirty, first, first + segment.numSamples);
+      }
+      segment.firstSample = first;
+      first += segment.numSamples;
+    }
+
+    // samples past the end of the shorter of the old and new buffers are
+    // mixed differently (or not at all)
+    if (size != track.buffer.size()) {
+      addSpan(dirty, std::min(size, track.buffer.size()),
+              std::max(size, track.buffer.size()));
+    }
+    if (moved) {
+      track.buffer = std::move(buffer);
+    }
+    track.rendered = std::move(rendered);
+    track.durationSeconds = seconds;
+  }
+
+  // the same arithmetic as mix_to, restricted to [first, last)
+  void mix(std::size_t first, std::size_t last, std::size_t shortest) {
+    if (first >= last) {
+      return;
+    }
+    const auto& shortestBuffer = tracks[shortest].buffer;
+    std::copy(shortestBuffer.begin() + first, shortestBuffer.begin() + last,
+              buffer.begin() + first);
+    const auto a = buffer.data();
+    double i = 2;
+    for (std::size_t track = 0; track < tracks.size(); ++track) {
+      if (track == shortest) {
+        continue;
+      }
+      const T weight = static_cast<T>(1 / i);
+      const T my_weight = 1 - weight;
+      const auto b = tracks[track].buffer.data();
+      const std::size_t end = std::min(last, tracks[track].buffer.size());
+      for (std::size_t j = first; j < end; ++j) {
+        a[j] = my_weight * a[j] + weight * b[j];
+      }
+      i += 1;
+    }
+  }
+
+  int sampleRate = 0;
+  std::vector<Track> tracks;
+  std::vector<T> buffer;
+  std::size_t mixedShortest = 0;
+  // set when tracks are added or removed
+  bool remixAll = true;
+};
+
+using IncrementalRenderer = BasicIncrementalRenderer<double>;
 }  // namespace amusia